@@ -2,26 +2,90 @@
 #include <GLFW/glfw3.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "profile.h"
 #include "vulkan_context.h"
 
 const uint32_t windowWidth = 800;
 const uint32_t windowHeight = 600;
+// Enough to refill both mesh upload batches each frame
+const uint32_t meshChunksPerFrame = 8;
+
+#ifndef NDEBUG
+// Dump the recorded CPU zones whenever F12 is pressed
+static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+        PROFILE_DUMP("trace.json");
+}
+#endif
+
+int main(int argc, char **argv) {
+    // Usage: vulkan_triangle [-s samples] [mesh]
+    uint32_t sampleCount = 1;
+    const char *meshFilename = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-s")) {
+            // The sample count must be a positive number, it is clamped to what the device supports later
+            char *end = NULL;
+            unsigned long value = i + 1 < argc ? strtoul(argv[++i], &end, 10) : 0;
+            if (!end || end == argv[i] || *end || value == 0 || value > 64) {
+                fprintf(stderr, "Usage: %s [-s samples] [mesh]\n", argv[0]);
+                fprintf(stderr, "samples must be a number between 1 and 64\n");
+                return -1;
+            }
+            sampleCount = (uint32_t) value;
+        } else if (!meshFilename) {
+            meshFilename = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-s samples] [mesh]\n", argv[0]);
+            return -1;
+        }
+    }
 
-int main() {
     // Initialize GLFW and create a window
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     GLFWwindow *window = glfwCreateWindow(windowWidth, windowHeight, "Vulkan", NULL, NULL);
+#ifndef NDEBUG
+    glfwSetKeyCallback(window, keyCallback);
+#endif
 
-    if (initializeVulkanContext(window) != VULKAN_CONTEXT_SUCCESS) {
+    PROFILE_ZONE_BEGIN("initializeVulkanContext");
+    int contextStatus = initializeVulkanContext(window, sampleCount);
+    PROFILE_ZONE_END();
+
+    if (contextStatus != VULKAN_CONTEXT_SUCCESS) {
         fprintf(stderr, "Failed to initialize renderer\n");
         return -1;
     }
 
+    // Optionally stream a binary mesh, a few chunks per frame
+    PROFILE_ZONE_BEGIN("beginMeshUpload");
+    int meshStatus = meshFilename ? beginMeshUpload(meshFilename) : VULKAN_CONTEXT_SUCCESS;
+    PROFILE_ZONE_END();
+
+    if (meshStatus != VULKAN_CONTEXT_SUCCESS) {
+        fprintf(stderr, "Failed to load mesh %s\n", meshFilename);
+        return -1;
+    }
+
     while (!glfwWindowShouldClose(window)) {
+        PROFILE_ZONE_BEGIN("frame");
+
+        PROFILE_ZONE_BEGIN("glfwPollEvents");
         glfwPollEvents();
+        PROFILE_ZONE_END();
+
+        if (streamMeshChunks(meshChunksPerFrame, NULL) != VULKAN_CONTEXT_SUCCESS) {
+            fprintf(stderr, "Failed to stream mesh %s\n", meshFilename);
+            PROFILE_ZONE_END();
+            return -1;
+        }
+
+        PROFILE_ZONE_END();
     }
 
     return 0;
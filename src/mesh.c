@@ -0,0 +1,158 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mesh.h"
+
+static uint32_t isRangeInFile(uint64_t offset, uint64_t size, size_t fileSize);
+
+int openMesh(const char *filename, struct Mesh *mesh) {
+    memset(mesh, 0, sizeof(*mesh));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open mesh file %s\n", filename);
+        return MESH_FAILURE;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || (size_t) fileStat.st_size < sizeof(struct MeshHeader)) {
+        fprintf(stderr, "Mesh file %s is too small\n", filename);
+        close(fd);
+        return MESH_FAILURE;
+    }
+
+    // Map the whole file; pages are faulted in lazily as chunks are copied out
+    size_t size = (size_t) fileStat.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Failed to map mesh file %s\n", filename);
+        return MESH_FAILURE;
+    }
+
+    // Chunks are read front to back, so let the kernel read ahead aggressively
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+    mesh->data = (const uint8_t *) data;
+    mesh->size = size;
+    mesh->header = (const struct MeshHeader *) data;
+
+    // Validate the header before trusting any offsets in it
+    const struct MeshHeader *header = mesh->header;
+    if (header->magic != MESH_MAGIC || header->version != MESH_VERSION) {
+        fprintf(stderr, "Mesh file %s has an unsupported header\n", filename);
+        closeMesh(mesh);
+        return MESH_FAILURE;
+    }
+
+    if (header->chunkCount == 0 || header->vertexStride == 0 || (header->indexSize != 2 && header->indexSize != 4) ||
+        header->vertexOffset % MESH_SECTION_ALIGNMENT || header->indexOffset % MESH_SECTION_ALIGNMENT ||
+        header->chunkTableOffset % _Alignof(struct MeshChunk) ||
+        header->vertexCount > UINT64_MAX / header->vertexStride ||
+        header->indexCount > UINT64_MAX / header->indexSize ||
+        !isRangeInFile(header->chunkTableOffset, (uint64_t) header->chunkCount * sizeof(struct MeshChunk), size) ||
+        !isRangeInFile(header->vertexOffset, header->vertexCount * header->vertexStride, size) ||
+        !isRangeInFile(header->indexOffset, header->indexCount * header->indexSize, size))
+    {
+        fprintf(stderr, "Mesh file %s has invalid section layout\n", filename);
+        closeMesh(mesh);
+        return MESH_FAILURE;
+    }
+
+    mesh->chunks = (const struct MeshChunk *) (mesh->data + header->chunkTableOffset);
+    mesh->vertices = mesh->data + header->vertexOffset;
+    mesh->indices = mesh->data + header->indexOffset;
+
+    // Chunks must tile both sections in file order, without gaps or overlap
+    uint64_t nextVertex = 0, nextIndex = 0;
+    for (size_t i = 0; i < header->chunkCount; ++i) {
+        const struct MeshChunk *chunk = &mesh->chunks[i];
+        if (chunk->firstVertex != nextVertex || chunk->firstIndex != nextIndex) {
+            fprintf(stderr, "Mesh file %s has an out of order chunk\n", filename);
+            closeMesh(mesh);
+            return MESH_FAILURE;
+        }
+
+        nextVertex += chunk->vertexCount;
+        nextIndex += chunk->indexCount;
+    }
+
+    if (nextVertex != header->vertexCount || nextIndex != header->indexCount) {
+        fprintf(stderr, "Mesh file %s has chunks that do not cover its sections\n", filename);
+        closeMesh(mesh);
+        return MESH_FAILURE;
+    }
+
+    return MESH_SUCCESS;
+}
+
+void closeMesh(struct Mesh *mesh) {
+    if (mesh->data) munmap((void *) mesh->data, mesh->size);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+void prefetchMeshChunk(const struct Mesh *mesh, uint32_t chunk) {
+    if (chunk >= mesh->header->chunkCount) return;
+
+    // Ask the kernel to start reading the chunk's pages while we work on the current one
+    const struct MeshChunk *meshChunk = &mesh->chunks[chunk];
+    long pageSize = sysconf(_SC_PAGESIZE);
+    const uint8_t *ranges[] = {
+        mesh->vertices + (size_t) meshChunk->firstVertex * mesh->header->vertexStride,
+        mesh->indices + (size_t) meshChunk->firstIndex * mesh->header->indexSize
+    };
+    size_t sizes[] = {
+        (size_t) meshChunk->vertexCount * mesh->header->vertexStride,
+        (size_t) meshChunk->indexCount * mesh->header->indexSize
+    };
+
+    for (size_t i = 0; i < 2; ++i) {
+        if (sizes[i] == 0) continue;
+        uintptr_t start = (uintptr_t) ranges[i] & ~(uintptr_t) (pageSize - 1);
+        posix_madvise((void *) start, (uintptr_t) ranges[i] + sizes[i] - start, POSIX_MADV_WILLNEED);
+    }
+}
+
+int copyMeshChunk(const struct Mesh *mesh, uint32_t chunk, uint8_t *vertexDst, uint8_t *indexDst) {
+    // The chunk's vertices and indices are written to the start of each destination
+    const struct MeshChunk *meshChunk = &mesh->chunks[chunk];
+    size_t vertexOffset = (size_t) meshChunk->firstVertex * mesh->header->vertexStride;
+    size_t indexOffset = (size_t) meshChunk->firstIndex * mesh->header->indexSize;
+
+    // Indices are relative to the chunk, so each one must stay below its vertex count.
+    // Check the mapped source rather than the destination, which may be slow to read back.
+    uint32_t maxIndex = 0;
+    if (mesh->header->indexSize == 2) {
+        const uint16_t *indices = (const uint16_t *) (mesh->indices + indexOffset);
+        for (uint32_t i = 0; i < meshChunk->indexCount; ++i)
+            if (indices[i] > maxIndex) maxIndex = indices[i];
+    } else {
+        const uint32_t *indices = (const uint32_t *) (mesh->indices + indexOffset);
+        for (uint32_t i = 0; i < meshChunk->indexCount; ++i)
+            if (indices[i] > maxIndex) maxIndex = indices[i];
+    }
+
+    if (meshChunk->indexCount > 0 && maxIndex >= meshChunk->vertexCount) {
+        fprintf(stderr, "Mesh chunk %u has indices past its %u vertices\n", chunk, meshChunk->vertexCount);
+        return MESH_FAILURE;
+    }
+
+    memcpy(vertexDst, mesh->vertices + vertexOffset,
+           (size_t) meshChunk->vertexCount * mesh->header->vertexStride);
+    memcpy(indexDst, mesh->indices + indexOffset,
+           (size_t) meshChunk->indexCount * mesh->header->indexSize);
+
+    return MESH_SUCCESS;
+}
+
+static uint32_t isRangeInFile(uint64_t offset, uint64_t size, size_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
@@ -0,0 +1,62 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary mesh container (all values little-endian):
+//
+//   MeshHeader
+//   MeshChunk[chunkCount]                  at chunkTableOffset
+//   vertex section (vertexStride bytes)    at vertexOffset, MESH_SECTION_ALIGNMENT aligned
+//   index section (indexSize bytes each)   at indexOffset, MESH_SECTION_ALIGNMENT aligned
+//
+// Each chunk owns a contiguous run of vertices and indices, and its indices
+// are relative to the chunk's first vertex. Chunks are laid out in file order
+// so they can be streamed front to back and drawn as soon as they arrive.
+
+#define MESH_MAGIC 0x4853454D /* "MESH" */
+#define MESH_VERSION 1
+#define MESH_SECTION_ALIGNMENT 16
+
+enum meshStatus { MESH_FAILURE, MESH_SUCCESS };
+
+struct MeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t indexSize;
+    uint32_t chunkCount;
+    uint32_t reserved;
+    uint64_t chunkTableOffset;
+    uint64_t vertexOffset;
+    uint64_t vertexCount;
+    uint64_t indexOffset;
+    uint64_t indexCount;
+};
+
+struct MeshChunk {
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+struct Mesh {
+    const uint8_t *data;
+    size_t size;
+    const struct MeshHeader *header;
+    const struct MeshChunk *chunks;
+    const uint8_t *vertices;
+    const uint8_t *indices;
+};
+
+int openMesh(const char *filename, struct Mesh *mesh);
+void closeMesh(struct Mesh *mesh);
+void prefetchMeshChunk(const struct Mesh *mesh, uint32_t chunk);
+// Fails without copying if any index is outside the chunk's vertices
+int copyMeshChunk(const struct Mesh *mesh, uint32_t chunk, uint8_t *vertexDst, uint8_t *indexDst);
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef NDEBUG
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "profile.h"
+
+// Must be a power of two so the write index can be masked into the ring
+#define PROFILE_RING_CAPACITY (1u << 16)
+// Deepest zone nesting whose names are tracked when writing end events
+#define PROFILE_MAX_DEPTH 64
+
+enum profileEventType { PROFILE_EVENT_BEGIN, PROFILE_EVENT_END };
+
+// Fields are relaxed atomics since dumps read slots the owning thread may be rewriting
+struct ProfileEvent {
+    _Atomic(const char *) name;
+    _Atomic uint64_t timestamp;
+    _Atomic uint32_t type;
+};
+
+struct ProfileRing {
+    struct ProfileEvent events[PROFILE_RING_CAPACITY];
+    _Atomic uint64_t writeIndex;
+    uint32_t threadId;
+    struct ProfileRing *next;
+};
+
+static void profileWriteEvent(FILE *file, uint32_t *firstEvent, const char *name, char phase,
+                              uint64_t timestamp, uint32_t threadId);
+static uint64_t profileTimestamp(void);
+static struct ProfileRing *profileThreadRing(void);
+static void profileRecord(const char *name, uint32_t type);
+
+// Every ring ever created, pushed once per thread and never removed
+static _Atomic(struct ProfileRing *) profileRings;
+static _Atomic uint32_t profileThreadCount;
+static _Thread_local struct ProfileRing *threadRing;
+
+void profileZoneBegin(const char *name) {
+    profileRecord(name, PROFILE_EVENT_BEGIN);
+}
+
+void profileZoneEnd(void) {
+    profileRecord(NULL, PROFILE_EVENT_END);
+}
+
+int profileDumpChromeTrace(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open trace file %s\n", filename);
+        return -1;
+    }
+
+    fprintf(file, "{\"traceEvents\":[");
+
+    uint32_t firstEvent = 1;
+    struct ProfileRing *ring = atomic_load_explicit(&profileRings, memory_order_acquire);
+    for (; ring; ring = ring->next) {
+        // Only the last PROFILE_RING_CAPACITY events of a thread are retained
+        uint64_t end = atomic_load_explicit(&ring->writeIndex, memory_order_acquire);
+        uint64_t begin = end > PROFILE_RING_CAPACITY ? end - PROFILE_RING_CAPACITY : 0;
+
+        // Zones open at the current point of the window, so end events can carry names
+        const char *openZones[PROFILE_MAX_DEPTH];
+        uint32_t depth = 0;
+        uint64_t lastTimestamp = 0;
+
+        for (uint64_t i = begin; i < end; ++i) {
+            struct ProfileEvent *slot = &ring->events[i & (PROFILE_RING_CAPACITY - 1)];
+            const char *name = atomic_load_explicit(&slot->name, memory_order_relaxed);
+            uint64_t timestamp = atomic_load_explicit(&slot->timestamp, memory_order_relaxed);
+            uint32_t type = atomic_load_explicit(&slot->type, memory_order_relaxed);
+
+            // The owning thread keeps recording while we read, so drop
+            // anything it may have overwritten or be overwriting by now
+            atomic_thread_fence(memory_order_acquire);
+            uint64_t current = atomic_load_explicit(&ring->writeIndex, memory_order_relaxed);
+            if (current - i >= PROFILE_RING_CAPACITY) continue;
+
+            if (type == PROFILE_EVENT_BEGIN) {
+                if (depth < PROFILE_MAX_DEPTH) openZones[depth] = name;
+                depth++;
+                profileWriteEvent(file, &firstEvent, name, 'B', timestamp, ring->threadId);
+            } else {
+                // Once the ring has wrapped, the window can start inside zones
+                // whose begin was evicted; their ends have nothing to close
+                if (depth == 0) continue;
+                depth--;
+                profileWriteEvent(file, &firstEvent, depth < PROFILE_MAX_DEPTH ? openZones[depth] : "",
+                                  'E', timestamp, ring->threadId);
+            }
+            lastTimestamp = timestamp;
+        }
+
+        // Close zones that are still open, such as the frame a dump was requested from
+        uint64_t now = profileTimestamp();
+        if (now < lastTimestamp) now = lastTimestamp;
+        while (depth > 0) {
+            depth--;
+            profileWriteEvent(file, &firstEvent, depth < PROFILE_MAX_DEPTH ? openZones[depth] : "",
+                              'E', now, ring->threadId);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    return 0;
+}
+
+static void profileWriteEvent(FILE *file,
+                              uint32_t *firstEvent,
+                              const char *name,
+                              char phase,
+                              uint64_t timestamp,
+                              uint32_t threadId)
+{
+    fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,\"tid\":%u}",
+            *firstEvent ? "" : ",", name, phase, timestamp / 1000.0, threadId);
+    *firstEvent = 0;
+}
+
+static uint64_t profileTimestamp(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+static struct ProfileRing *profileThreadRing(void) {
+    if (threadRing) return threadRing;
+
+    struct ProfileRing *ring = (struct ProfileRing *) calloc(1, sizeof(struct ProfileRing));
+    if (!ring) return NULL;
+
+    ring->threadId = atomic_fetch_add_explicit(&profileThreadCount, 1, memory_order_relaxed);
+
+    // Publish the ring so dumps from any thread can find it
+    struct ProfileRing *head = atomic_load_explicit(&profileRings, memory_order_relaxed);
+    do {
+        ring->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&profileRings, &head, ring,
+                                                    memory_order_release, memory_order_relaxed));
+
+    threadRing = ring;
+    return ring;
+}
+
+static void profileRecord(const char *name, uint32_t type) {
+    struct ProfileRing *ring = profileThreadRing();
+    if (!ring) return;
+
+    uint64_t index = atomic_load_explicit(&ring->writeIndex, memory_order_relaxed);
+
+    // A release store only orders earlier writes, so fence here to keep the
+    // slot writes below from becoming visible before the previous index store.
+    // Pairs with the acquire fence in the dump's overwrite check.
+    atomic_thread_fence(memory_order_release);
+
+    struct ProfileEvent *event = &ring->events[index & (PROFILE_RING_CAPACITY - 1)];
+    atomic_store_explicit(&event->name, name, memory_order_relaxed);
+    atomic_store_explicit(&event->timestamp, profileTimestamp(), memory_order_relaxed);
+    atomic_store_explicit(&event->type, type, memory_order_relaxed);
+
+    // Release so a dump that observes the new index also observes the event
+    atomic_store_explicit(&ring->writeIndex, index + 1, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// CPU instrumentation zones
+//
+// Zones are recorded into a per-thread ring buffer that only its own thread
+// writes to, so recording never takes a lock. The most recent events of every
+// thread can be dumped to a Chrome trace (chrome://tracing, Perfetto) at any
+// time. Zone names must be string literals since only the pointer is stored.
+// Release builds (NDEBUG) compile all of this out.
+
+#ifndef NDEBUG
+
+void profileZoneBegin(const char *name);
+void profileZoneEnd(void);
+int profileDumpChromeTrace(const char *filename);
+
+#define PROFILE_ZONE_BEGIN(name) profileZoneBegin(name)
+#define PROFILE_ZONE_END() profileZoneEnd()
+#define PROFILE_DUMP(filename) profileDumpChromeTrace(filename)
+
+#else
+
+#define PROFILE_ZONE_BEGIN(name) ((void) 0)
+#define PROFILE_ZONE_END() ((void) 0)
+#define PROFILE_DUMP(filename) ((void) 0)
+
+#endif
+
+#endif
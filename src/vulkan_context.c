@@ -5,11 +5,14 @@
 
 #include "vulkan_context.h"
 
+#include "mesh.h"
+#include "profile.h"
 #include "util.h"
 
 static uint32_t isDeviceSuitable(VkPhysicalDevice device);
 static struct QueueFamilyIndices getQueueFamilies(VkPhysicalDevice device);
 static uint32_t checkDeviceExtensionSupport(VkPhysicalDevice device);
+static uint32_t checkInstanceExtensionSupport(const char *extensionName);
 static struct SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 static VkSurfaceFormatKHR chooseSwapSurfaceFormat(const VkSurfaceFormatKHR *availableFormats, uint32_t formatsCount);
 static VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR *availablePresentModes, uint32_t presentModesCount);
@@ -20,6 +23,20 @@ static VkResult createRenderPass(VkDevice device);
 static VkResult createGraphicsPipeline(VkDevice device);
 static VkFramebuffer *createFramebuffers(VkDevice device, VkImageView *swapChainImageViews, uint32_t imageCount);
 static VkShaderModule createShaderModule(VkDevice device, const uint8_t *code, uint32_t size);
+static VkSampleCountFlagBits chooseSampleCount(VkPhysicalDevice device, uint32_t requestedSamples);
+static VkResult createColorResources(VkDevice device);
+static void destroyColorResources(void);
+static VkResult createUploadCommands(VkDevice device, struct QueueFamilyIndices queueFamilyIndices);
+static int32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+static VkResult createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                             VkBuffer *buffer, VkDeviceMemory *memory);
+static void destroyMeshStaging(void);
+static void destroyMeshBuffers(void);
+static VkResult submitMeshUploadBatch(uint32_t batchIndex, uint32_t chunkCount);
+static void beginCommandZone(VkCommandBuffer commandBuffer, const char *name);
+static void endCommandZone(VkCommandBuffer commandBuffer);
+static void beginQueueZone(VkQueue queue, const char *name);
+static void endQueueZone(VkQueue queue);
 
 #define ARRAY_LENGTH(arr) (sizeof(arr) / sizeof((arr)[0]))
 
@@ -32,8 +49,58 @@ static VkExtent2D swapChainExtent;
 static VkRenderPass renderPass;
 static VkPipelineLayout pipelineLayout;
 static VkPipeline graphicsPipeline;
+static VkFramebuffer *swapChainFramebuffers;
+static VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+static VkImage colorImage;
+static VkDeviceMemory colorImageMemory;
+static VkImageView colorImageView;
+static VkPhysicalDevice physicalDevice;
+static VkDevice device;
+static VkQueue graphicsQueue;
+static VkCommandPool commandPool;
+
+// Mesh streaming state
+// Chunks are copied into a fixed ring of staging slots, each large enough for
+// the biggest chunk, so staging memory does not grow with the mesh. The ring
+// is split between upload batches: while the GPU copies one batch out of its
+// slots, the next batch is filled from the mapped file. The file and the
+// staging buffer stay mapped until every chunk has been copied into the
+// device local vertex and index buffers.
+#define MESH_UPLOAD_BATCHES 2
+#define MESH_SLOTS_PER_BATCH 4
+
+struct MeshUploadBatch {
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    uint32_t chunkCount;
+};
+
+static struct Mesh mesh;
+static VkBuffer meshStagingBuffer;
+static VkDeviceMemory meshStagingMemory;
+static uint8_t *meshStagingData;
+static VkDeviceSize meshStagingSlotSize;
+static VkDeviceSize meshStagingSlotIndexOffset;
+static VkBuffer meshVertexBuffer;
+static VkDeviceMemory meshVertexMemory;
+static VkBuffer meshIndexBuffer;
+static VkDeviceMemory meshIndexMemory;
+static uint32_t meshChunkCount;
+static uint32_t meshChunksResident;
+static uint32_t meshChunksQueued;
+static struct MeshUploadBatch meshUploadBatches[MESH_UPLOAD_BATCHES];
+static uint32_t meshBatchHead;
+static uint32_t meshBatchTail;
+
+// Debug utils labels mirror CPU zones on the GPU timeline (debug builds only)
+#ifndef NDEBUG
+static PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginDebugUtilsLabel;
+static PFN_vkCmdEndDebugUtilsLabelEXT cmdEndDebugUtilsLabel;
+static PFN_vkQueueBeginDebugUtilsLabelEXT queueBeginDebugUtilsLabel;
+static PFN_vkQueueEndDebugUtilsLabelEXT queueEndDebugUtilsLabel;
+#endif
 
-int initializeVulkanContext(GLFWwindow *window) {
+int initializeVulkanContext(GLFWwindow *window, uint32_t sampleCount) {
     // Specify information necessary to create a Vulkan instance
     VkInstanceCreateInfo instanceCreateInfo = {};
     instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -42,14 +109,21 @@ int initializeVulkanContext(GLFWwindow *window) {
     // GLFW has a function that returns the extensions it needs.
     uint32_t extensionCount = 0;
     const char **glfwExtensions;
-    if ((glfwExtensions = glfwGetRequiredInstanceExtensions(&extensionCount))) {
-        instanceCreateInfo.enabledExtensionCount = extensionCount;
-        instanceCreateInfo.ppEnabledExtensionNames = glfwExtensions;
-    } else {
+    if (!(glfwExtensions = glfwGetRequiredInstanceExtensions(&extensionCount))) {
         fprintf(stderr, "Failed to satisfy GLFW's extension requirements\n");
         return VULKAN_CONTEXT_FAILURE;
     }
 
+    // Debug builds also enable debug utils when available so GPU work can be labelled
+    const char *instanceExtensions[extensionCount + 1];
+    memcpy(instanceExtensions, glfwExtensions, sizeof(const char *) * extensionCount);
+#ifndef NDEBUG
+    uint32_t debugUtilsEnabled = checkInstanceExtensionSupport(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    if (debugUtilsEnabled) instanceExtensions[extensionCount++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+#endif
+    instanceCreateInfo.enabledExtensionCount = extensionCount;
+    instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions;
+
     // Specify desired validation layers (debug builds only)
 #ifndef NDEBUG
     instanceCreateInfo.enabledLayerCount = ARRAY_LENGTH(validationLayers);
@@ -60,11 +134,29 @@ int initializeVulkanContext(GLFWwindow *window) {
 
     // Create a Vulkan instance using the information declared above
     VkInstance instance;
-    if (vkCreateInstance(&instanceCreateInfo, NULL, &instance) != VK_SUCCESS) {
+    PROFILE_ZONE_BEGIN("vkCreateInstance");
+    VkResult instanceResult = vkCreateInstance(&instanceCreateInfo, NULL, &instance);
+    PROFILE_ZONE_END();
+
+    if (instanceResult != VK_SUCCESS) {
         fprintf(stderr, "Failed to create Vulkan instance\n");
         return VULKAN_CONTEXT_FAILURE;
     }
 
+    // Without the extension the label functions stay NULL and labelling is skipped
+#ifndef NDEBUG
+    if (debugUtilsEnabled) {
+        cmdBeginDebugUtilsLabel = (PFN_vkCmdBeginDebugUtilsLabelEXT)
+            vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+        cmdEndDebugUtilsLabel = (PFN_vkCmdEndDebugUtilsLabelEXT)
+            vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+        queueBeginDebugUtilsLabel = (PFN_vkQueueBeginDebugUtilsLabelEXT)
+            vkGetInstanceProcAddr(instance, "vkQueueBeginDebugUtilsLabelEXT");
+        queueEndDebugUtilsLabel = (PFN_vkQueueEndDebugUtilsLabelEXT)
+            vkGetInstanceProcAddr(instance, "vkQueueEndDebugUtilsLabelEXT");
+    }
+#endif
+
     // Create a window surface
     if (glfwCreateWindowSurface(instance, window, NULL, &surface) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create window surface\n");
@@ -83,7 +175,7 @@ int initializeVulkanContext(GLFWwindow *window) {
         return VULKAN_CONTEXT_FAILURE;
     }
 
-    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    physicalDevice = VK_NULL_HANDLE;
     for (size_t i = 0; i < physicalDeviceCount; ++i) {
         if (isDeviceSuitable(physicalDevices[i])) {
             physicalDevice = physicalDevices[i];
@@ -96,6 +188,9 @@ int initializeVulkanContext(GLFWwindow *window) {
         return VULKAN_CONTEXT_FAILURE;
     }
 
+    // Clamp the requested MSAA sample count to what the device can render to
+    msaaSamples = chooseSampleCount(physicalDevice, sampleCount);
+
     // Specify which and how many queues we want
     struct QueueFamilyIndices queueFamilyIndices = getQueueFamilies(physicalDevice);
 
@@ -128,24 +223,28 @@ int initializeVulkanContext(GLFWwindow *window) {
 
     // Create a logical device using the information declared above
     // Device queues are automatically created here as well
-    VkDevice device;
-    if (vkCreateDevice(physicalDevice, &deviceCreateInfo, NULL, &device) != VK_SUCCESS) {
+    PROFILE_ZONE_BEGIN("vkCreateDevice");
+    VkResult deviceResult = vkCreateDevice(physicalDevice, &deviceCreateInfo, NULL, &device);
+    PROFILE_ZONE_END();
+
+    if (deviceResult != VK_SUCCESS) {
         fprintf(stderr, "Failed to create the logical device\n");
         return VULKAN_CONTEXT_FAILURE;
     }
 
     // Get a handle for each queue
-    VkQueue graphicsQueue;
     vkGetDeviceQueue(device, queueFamilyIndices.graphics, 0, &graphicsQueue);
 
     VkQueue presentQueue;
     vkGetDeviceQueue(device, queueFamilyIndices.present, 0, &presentQueue);
 
     // Create a swap chain
+    PROFILE_ZONE_BEGIN("createSwapChain");
     VkSwapchainKHR swapChain = createSwapChain(
         physicalDevice, device, window, 
         queueFamilyIndices, indices, ARRAY_LENGTH(indices)
     );
+    PROFILE_ZONE_END();
 
     if (!swapChain) {
         fprintf(stderr, "Failed to create swap chain\n");
@@ -177,18 +276,266 @@ int initializeVulkanContext(GLFWwindow *window) {
         imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
         imageViewCreateInfo.subresourceRange.layerCount = 1;
         
-        if (vkCreateImageView(device, &imageViewCreateInfo, NULL, swapChainImageViews) != VK_SUCCESS) {
+        if (vkCreateImageView(device, &imageViewCreateInfo, NULL, &swapChainImageViews[i]) != VK_SUCCESS) {
             fprintf(stderr, "Failed to create swap chain image views\n");
             return VULKAN_CONTEXT_FAILURE;
         }
     }
 
-    createRenderPass(device);
-    createGraphicsPipeline(device);
+    PROFILE_ZONE_BEGIN("createRenderPass");
+    VkResult renderPassResult = createRenderPass(device);
+    PROFILE_ZONE_END();
+
+    if (renderPassResult != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create render pass\n");
+        return VULKAN_CONTEXT_FAILURE;
+    }
+
+    PROFILE_ZONE_BEGIN("createGraphicsPipeline");
+    VkResult pipelineResult = createGraphicsPipeline(device);
+    PROFILE_ZONE_END();
+
+    if (pipelineResult != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create graphics pipeline\n");
+        return VULKAN_CONTEXT_FAILURE;
+    }
+
+    PROFILE_ZONE_BEGIN("createColorResources");
+    VkResult colorResult = createColorResources(device);
+    PROFILE_ZONE_END();
+
+    if (colorResult != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create multisampled color attachment\n");
+        return VULKAN_CONTEXT_FAILURE;
+    }
+
+    PROFILE_ZONE_BEGIN("createFramebuffers");
+    swapChainFramebuffers = createFramebuffers(device, swapChainImageViews, swapChainImageCount);
+    PROFILE_ZONE_END();
+
+    if (!swapChainFramebuffers) {
+        fprintf(stderr, "Failed to create framebuffers\n");
+        return VULKAN_CONTEXT_FAILURE;
+    }
+
+    if (createUploadCommands(device, queueFamilyIndices) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create upload command buffer\n");
+        return VULKAN_CONTEXT_FAILURE;
+    }
 
     return VULKAN_CONTEXT_SUCCESS;
 }
 
+int beginMeshUpload(const char *filename) {
+    if (openMesh(filename, &mesh) != MESH_SUCCESS)
+        return VULKAN_CONTEXT_FAILURE;
+
+    const struct MeshHeader *header = mesh.header;
+    VkDeviceSize vertexBytes = header->vertexCount * header->vertexStride;
+    VkDeviceSize indexBytes = header->indexCount * header->indexSize;
+
+    if (vertexBytes == 0 || indexBytes == 0) {
+        fprintf(stderr, "Mesh file %s contains no geometry\n", filename);
+        closeMesh(&mesh);
+        return VULKAN_CONTEXT_FAILURE;
+    }
+
+    // Size each staging slot for the largest chunk, indices start at the next aligned offset
+    VkDeviceSize maxChunkVertexBytes = 0, maxChunkIndexBytes = 0;
+    for (uint32_t i = 0; i < header->chunkCount; ++i) {
+        VkDeviceSize chunkVertexBytes = (VkDeviceSize) mesh.chunks[i].vertexCount * header->vertexStride;
+        VkDeviceSize chunkIndexBytes = (VkDeviceSize) mesh.chunks[i].indexCount * header->indexSize;
+        if (chunkVertexBytes > maxChunkVertexBytes) maxChunkVertexBytes = chunkVertexBytes;
+        if (chunkIndexBytes > maxChunkIndexBytes) maxChunkIndexBytes = chunkIndexBytes;
+    }
+
+    VkDeviceSize alignmentMask = MESH_SECTION_ALIGNMENT - 1;
+    meshStagingSlotIndexOffset = (maxChunkVertexBytes + alignmentMask) & ~alignmentMask;
+    meshStagingSlotSize = meshStagingSlotIndexOffset + ((maxChunkIndexBytes + alignmentMask) & ~alignmentMask);
+
+    if (createBuffer(meshStagingSlotSize * MESH_SLOTS_PER_BATCH * MESH_UPLOAD_BATCHES, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &meshStagingBuffer, &meshStagingMemory) != VK_SUCCESS ||
+        vkMapMemory(device, meshStagingMemory, 0, VK_WHOLE_SIZE, 0, (void **) &meshStagingData) != VK_SUCCESS)
+    {
+        fprintf(stderr, "Failed to create mesh staging buffer\n");
+        destroyMeshStaging();
+        return VULKAN_CONTEXT_FAILURE;
+    }
+
+    if (createBuffer(vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshVertexBuffer, &meshVertexMemory) != VK_SUCCESS ||
+        createBuffer(indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshIndexBuffer, &meshIndexMemory) != VK_SUCCESS)
+    {
+        fprintf(stderr, "Failed to create mesh vertex and index buffers\n");
+        destroyMeshBuffers();
+        destroyMeshStaging();
+        return VULKAN_CONTEXT_FAILURE;
+    }
+
+    meshChunkCount = header->chunkCount;
+    meshChunksResident = 0;
+    meshChunksQueued = 0;
+    meshBatchHead = 0;
+    meshBatchTail = 0;
+    prefetchMeshChunk(&mesh, 0);
+
+    return VULKAN_CONTEXT_SUCCESS;
+}
+
+int streamMeshChunks(uint32_t maxChunks, uint32_t *residentChunks) {
+    if (residentChunks) *residentChunks = meshChunksResident;
+    if (!meshStagingData)
+        return VULKAN_CONTEXT_SUCCESS;
+
+    PROFILE_ZONE_BEGIN("streamMeshChunks");
+
+    // Retire finished batches in submission order. Their chunks become
+    // resident and their staging slots free. Never block the frame on this.
+    while (meshUploadBatches[meshBatchTail].chunkCount > 0) {
+        struct MeshUploadBatch *batch = &meshUploadBatches[meshBatchTail];
+        VkResult fenceStatus = vkGetFenceStatus(device, batch->fence);
+        if (fenceStatus == VK_NOT_READY) break;
+
+        // Anything else, such as a lost device, means the upload will never finish
+        if (fenceStatus != VK_SUCCESS) {
+            fprintf(stderr, "Failed to wait for mesh upload\n");
+            destroyMeshStaging();
+            PROFILE_ZONE_END();
+            return VULKAN_CONTEXT_FAILURE;
+        }
+
+        vkResetFences(device, 1, &batch->fence);
+        vkResetCommandBuffer(batch->commandBuffer, 0);
+        meshChunksResident += batch->chunkCount;
+        batch->chunkCount = 0;
+        meshBatchTail = (meshBatchTail + 1) % MESH_UPLOAD_BATCHES;
+    }
+
+    // The staging memory and the file mapping are no longer needed once everything is resident
+    if (residentChunks) *residentChunks = meshChunksResident;
+    if (meshChunksResident == meshChunkCount) {
+        destroyMeshStaging();
+        PROFILE_ZONE_END();
+        return VULKAN_CONTEXT_SUCCESS;
+    }
+
+    // Fill every free batch, up to maxChunks chunks per call
+    uint32_t chunkBudget = maxChunks;
+    while (chunkBudget > 0 && meshChunksQueued < meshChunkCount &&
+           meshUploadBatches[meshBatchHead].chunkCount == 0)
+    {
+        uint32_t chunkCount = meshChunkCount - meshChunksQueued;
+        if (chunkCount > chunkBudget) chunkCount = chunkBudget;
+        if (chunkCount > MESH_SLOTS_PER_BATCH) chunkCount = MESH_SLOTS_PER_BATCH;
+
+        if (submitMeshUploadBatch(meshBatchHead, chunkCount) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to submit mesh upload\n");
+            PROFILE_ZONE_END();
+            return VULKAN_CONTEXT_FAILURE;
+        }
+
+        chunkBudget -= chunkCount;
+        meshBatchHead = (meshBatchHead + 1) % MESH_UPLOAD_BATCHES;
+    }
+
+    PROFILE_ZONE_END();
+
+    return VULKAN_CONTEXT_SUCCESS;
+}
+
+static VkResult submitMeshUploadBatch(uint32_t batchIndex, uint32_t chunkCount) {
+    struct MeshUploadBatch *batch = &meshUploadBatches[batchIndex];
+    uint32_t firstChunk = meshChunksQueued;
+    VkDeviceSize firstSlotOffset = (VkDeviceSize) batchIndex * MESH_SLOTS_PER_BATCH * meshStagingSlotSize;
+
+    // Copy each chunk out of the mapped file into the batch's staging slots
+    // while the kernel reads the next one in
+    PROFILE_ZONE_BEGIN("copyMeshChunks");
+    for (uint32_t slot = 0; slot < chunkCount; ++slot) {
+        VkDeviceSize slotOffset = firstSlotOffset + slot * meshStagingSlotSize;
+
+        prefetchMeshChunk(&mesh, firstChunk + slot + 1);
+        if (copyMeshChunk(&mesh, firstChunk + slot, meshStagingData + slotOffset,
+                          meshStagingData + slotOffset + meshStagingSlotIndexOffset) != MESH_SUCCESS)
+        {
+            PROFILE_ZONE_END();
+            return VK_ERROR_FORMAT_NOT_SUPPORTED;
+        }
+    }
+    PROFILE_ZONE_END();
+
+    VkCommandBufferBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch->commandBuffer, &beginInfo);
+    beginCommandZone(batch->commandBuffer, "recordMeshUpload");
+
+    const struct MeshHeader *header = mesh.header;
+    for (uint32_t slot = 0; slot < chunkCount; ++slot) {
+        uint32_t i = firstChunk + slot;
+        VkDeviceSize slotOffset = firstSlotOffset + slot * meshStagingSlotSize;
+
+        const struct MeshChunk *chunk = &mesh.chunks[i];
+        if (chunk->vertexCount > 0) {
+            VkBufferCopy vertexRegion = {0};
+            vertexRegion.srcOffset = slotOffset;
+            vertexRegion.dstOffset = (VkDeviceSize) chunk->firstVertex * header->vertexStride;
+            vertexRegion.size = (VkDeviceSize) chunk->vertexCount * header->vertexStride;
+            vkCmdCopyBuffer(batch->commandBuffer, meshStagingBuffer, meshVertexBuffer, 1, &vertexRegion);
+        }
+
+        if (chunk->indexCount > 0) {
+            VkBufferCopy indexRegion = {0};
+            indexRegion.srcOffset = slotOffset + meshStagingSlotIndexOffset;
+            indexRegion.dstOffset = (VkDeviceSize) chunk->firstIndex * header->indexSize;
+            indexRegion.size = (VkDeviceSize) chunk->indexCount * header->indexSize;
+            vkCmdCopyBuffer(batch->commandBuffer, meshStagingBuffer, meshIndexBuffer, 1, &indexRegion);
+        }
+    }
+
+    // Make the copies visible to vertex input in any later submission on this queue
+    VkBufferMemoryBarrier barriers[2] = {{0}, {0}};
+    for (size_t i = 0; i < ARRAY_LENGTH(barriers); ++i) {
+        barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].offset = 0;
+        barriers[i].size = VK_WHOLE_SIZE;
+    }
+    barriers[0].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    barriers[0].buffer = meshVertexBuffer;
+    barriers[1].dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+    barriers[1].buffer = meshIndexBuffer;
+
+    vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         0, 0, NULL, ARRAY_LENGTH(barriers), barriers, 0, NULL);
+
+    endCommandZone(batch->commandBuffer);
+    vkEndCommandBuffer(batch->commandBuffer);
+
+    VkSubmitInfo submitInfo = {0};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch->commandBuffer;
+
+    beginQueueZone(graphicsQueue, "submitMeshUpload");
+    VkResult submitResult = vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch->fence);
+    endQueueZone(graphicsQueue);
+
+    if (submitResult != VK_SUCCESS) {
+        vkResetCommandBuffer(batch->commandBuffer, 0);
+        return submitResult;
+    }
+
+    batch->chunkCount = chunkCount;
+    meshChunksQueued += chunkCount;
+
+    return VK_SUCCESS;
+}
+
 static uint32_t isDeviceSuitable(VkPhysicalDevice device) {
     /*VkPhysicalDeviceProperties deviceProperties;
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
@@ -261,6 +608,22 @@ static uint32_t checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return extensionsSatisfied;
 }
 
+static uint32_t checkInstanceExtensionSupport(const char *extensionName) {
+    // Query amount of available instance extensions
+    uint32_t extensionCount;
+    vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
+
+    // Store properties of the available extensions
+    VkExtensionProperties availableExtensions[extensionCount];
+    vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, availableExtensions);
+
+    for (size_t i = 0; i < extensionCount; ++i) {
+        if (!strcmp(extensionName, availableExtensions[i].extensionName)) return 1;
+    }
+
+    return 0;
+}
+
 static struct SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
     struct SwapChainSupportDetails details = {0};
 
@@ -388,29 +751,53 @@ static VkSwapchainKHR createSwapChain(VkPhysicalDevice physicalDevice,
 }
 
 static VkResult createRenderPass(VkDevice device) {
+    uint32_t multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+    // The color attachment is rendered to at msaaSamples. When multisampling,
+    // it only lives for the duration of the subpass: it is cleared on load and
+    // never stored, so tile based GPUs never write it back to memory.
     VkAttachmentDescription colorAttachment = {0};
     colorAttachment.format = swapChainImageFormat.format;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.samples = msaaSamples;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    // The resolve target is the swap chain image, which is fully overwritten
+    // by the resolve so its previous contents never need to be loaded
+    VkAttachmentDescription colorAttachmentResolve = {0};
+    colorAttachmentResolve.format = swapChainImageFormat.format;
+    colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentDescription attachments[] = {colorAttachment, colorAttachmentResolve};
 
     VkAttachmentReference colorAttachmentRef = {0};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference colorAttachmentResolveRef = {0};
+    colorAttachmentResolveRef.attachment = 1;
+    colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass = {0};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pResolveAttachments = multisampled ? &colorAttachmentResolveRef : NULL;
 
     VkRenderPassCreateInfo renderPassCreateInfo = {0};
     renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &colorAttachment;
+    renderPassCreateInfo.attachmentCount = multisampled ? ARRAY_LENGTH(attachments) : 1;
+    renderPassCreateInfo.pAttachments = attachments;
     renderPassCreateInfo.subpassCount = 1;
     renderPassCreateInfo.pSubpasses = &subpass;
 
@@ -434,6 +821,12 @@ static VkResult createGraphicsPipeline(VkDevice device) {
     free(vertShaderCode);
     free(fragShaderCode);
 
+    if (!vertShaderModule || !fragShaderModule) {
+        if (vertShaderModule) vkDestroyShaderModule(device, vertShaderModule, NULL);
+        if (fragShaderModule) vkDestroyShaderModule(device, fragShaderModule, NULL);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
     // Specify information regarding the shader stages in the pipeline
     VkPipelineShaderStageCreateInfo vertStageCreateInfo = {0};
     vertStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -498,7 +891,7 @@ static VkResult createGraphicsPipeline(VkDevice device) {
     VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {0};
     multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-    multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampleCreateInfo.rasterizationSamples = msaaSamples;
     multisampleCreateInfo.minSampleShading = 1.0f;
     multisampleCreateInfo.pSampleMask = NULL;
     multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
@@ -582,15 +975,20 @@ static VkFramebuffer *createFramebuffers(VkDevice device, VkImageView *swapChain
     VkFramebuffer *framebuffers = (VkFramebuffer *) malloc(sizeof(VkFramebuffer) * imageCount);
 
     for (size_t i = 0; i < imageCount; ++i) {
-        VkImageView attachments[] = {
-            swapChainImageViews[i]
-        };
+        // Without multisampling the swap chain image is rendered to directly
+        VkImageView multisampledAttachments[] = {colorImageView, swapChainImageViews[i]};
+        VkImageView singleSampledAttachments[] = {swapChainImageViews[i]};
 
         VkFramebufferCreateInfo framebufferCreateInfo = {0};
         framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferCreateInfo.renderPass = renderPass;
-        framebufferCreateInfo.attachmentCount = 1;
-        framebufferCreateInfo.pAttachments = attachments;
+        if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+            framebufferCreateInfo.attachmentCount = ARRAY_LENGTH(multisampledAttachments);
+            framebufferCreateInfo.pAttachments = multisampledAttachments;
+        } else {
+            framebufferCreateInfo.attachmentCount = ARRAY_LENGTH(singleSampledAttachments);
+            framebufferCreateInfo.pAttachments = singleSampledAttachments;
+        }
         framebufferCreateInfo.width = swapChainExtent.width;
         framebufferCreateInfo.height = swapChainExtent.height;
         framebufferCreateInfo.layers = 1;
@@ -603,6 +1001,8 @@ static VkFramebuffer *createFramebuffers(VkDevice device, VkImageView *swapChain
 }
 
 static VkShaderModule createShaderModule(VkDevice device, const uint8_t *code, uint32_t size) {
+    if (!code || size == 0) return NULL;
+
     // Specify information necessary to create a shader module
     VkShaderModuleCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -615,4 +1015,264 @@ static VkShaderModule createShaderModule(VkDevice device, const uint8_t *code, u
         return NULL;
 
     return shaderModule;
+}
+
+static VkSampleCountFlagBits chooseSampleCount(VkPhysicalDevice device, uint32_t requestedSamples) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+    // Depth attachments will share the sample count, so respect both limits
+    VkSampleCountFlags supportedCounts = deviceProperties.limits.framebufferColorSampleCounts &
+                                         deviceProperties.limits.framebufferDepthSampleCounts;
+
+    // Pick the highest supported count that does not exceed the request
+    VkSampleCountFlagBits counts[] = {
+        VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT, VK_SAMPLE_COUNT_16_BIT,
+        VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT
+    };
+
+    for (size_t i = 0; i < ARRAY_LENGTH(counts); ++i) {
+        if ((uint32_t) counts[i] <= requestedSamples && (supportedCounts & counts[i]))
+            return counts[i];
+    }
+
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
+static VkResult createColorResources(VkDevice device) {
+    if (msaaSamples == VK_SAMPLE_COUNT_1_BIT) return VK_SUCCESS;
+
+    // The multisampled image is never loaded or stored outside the render pass,
+    // so it can be transient and, where supported, never get physical backing
+    VkImageCreateInfo imageCreateInfo = {0};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.extent.width = swapChainExtent.width;
+    imageCreateInfo.extent.height = swapChainExtent.height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.format = swapChainImageFormat.format;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    imageCreateInfo.samples = msaaSamples;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(device, &imageCreateInfo, NULL, &colorImage) != VK_SUCCESS) {
+        colorImage = VK_NULL_HANDLE;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, colorImage, &memoryRequirements);
+
+    // Prefer lazily allocated memory, falling back to regular device local memory
+    int32_t memoryType = findMemoryType(memoryRequirements.memoryTypeBits,
+                                        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    if (memoryType < 0)
+        memoryType = findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // Don't leave a half created image behind on failure
+    if (memoryType < 0) {
+        destroyColorResources();
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkMemoryAllocateInfo allocateInfo = {0};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = memoryRequirements.size;
+    allocateInfo.memoryTypeIndex = (uint32_t) memoryType;
+
+    if (vkAllocateMemory(device, &allocateInfo, NULL, &colorImageMemory) != VK_SUCCESS) {
+        colorImageMemory = VK_NULL_HANDLE;
+        destroyColorResources();
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    if (vkBindImageMemory(device, colorImage, colorImageMemory, 0) != VK_SUCCESS) {
+        destroyColorResources();
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkImageViewCreateInfo imageViewCreateInfo = {0};
+    imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewCreateInfo.image = colorImage;
+    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewCreateInfo.format = swapChainImageFormat.format;
+    imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+    imageViewCreateInfo.subresourceRange.levelCount = 1;
+    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device, &imageViewCreateInfo, NULL, &colorImageView) != VK_SUCCESS) {
+        colorImageView = VK_NULL_HANDLE;
+        destroyColorResources();
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    return VK_SUCCESS;
+}
+
+static void destroyColorResources(void) {
+    if (colorImageView) vkDestroyImageView(device, colorImageView, NULL);
+    if (colorImage) vkDestroyImage(device, colorImage, NULL);
+    if (colorImageMemory) vkFreeMemory(device, colorImageMemory, NULL);
+
+    colorImageView = VK_NULL_HANDLE;
+    colorImage = VK_NULL_HANDLE;
+    colorImageMemory = VK_NULL_HANDLE;
+}
+
+static VkResult createUploadCommands(VkDevice device, struct QueueFamilyIndices queueFamilyIndices) {
+    VkCommandPoolCreateInfo poolCreateInfo = {0};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolCreateInfo.queueFamilyIndex = (uint32_t) queueFamilyIndices.graphics;
+
+    if (vkCreateCommandPool(device, &poolCreateInfo, NULL, &commandPool) != VK_SUCCESS)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    VkCommandBufferAllocateInfo allocateInfo = {0};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = commandPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+
+    VkFenceCreateInfo fenceCreateInfo = {0};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    // Each upload batch gets its own command buffer and fence so batches can be in flight together
+    for (size_t i = 0; i < MESH_UPLOAD_BATCHES; ++i) {
+        if (vkAllocateCommandBuffers(device, &allocateInfo, &meshUploadBatches[i].commandBuffer) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceCreateInfo, NULL, &meshUploadBatches[i].fence) != VK_SUCCESS)
+            return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    return VK_SUCCESS;
+}
+
+static int32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        if ((typeFilter & (1u << i)) &&
+            (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            return (int32_t) i;
+    }
+
+    return -1;
+}
+
+static VkResult createBuffer(VkDeviceSize size,
+                             VkBufferUsageFlags usage,
+                             VkMemoryPropertyFlags properties,
+                             VkBuffer *buffer,
+                             VkDeviceMemory *memory)
+{
+    VkBufferCreateInfo bufferCreateInfo = {0};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = usage;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferCreateInfo, NULL, buffer) != VK_SUCCESS)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, *buffer, &memoryRequirements);
+
+    // Don't leave a half created buffer behind on failure
+    int32_t memoryType = findMemoryType(memoryRequirements.memoryTypeBits, properties);
+    if (memoryType < 0) {
+        vkDestroyBuffer(device, *buffer, NULL);
+        *buffer = VK_NULL_HANDLE;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkMemoryAllocateInfo allocateInfo = {0};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = memoryRequirements.size;
+    allocateInfo.memoryTypeIndex = (uint32_t) memoryType;
+
+    if (vkAllocateMemory(device, &allocateInfo, NULL, memory) != VK_SUCCESS) {
+        vkDestroyBuffer(device, *buffer, NULL);
+        *buffer = VK_NULL_HANDLE;
+        *memory = VK_NULL_HANDLE;
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    if (vkBindBufferMemory(device, *buffer, *memory, 0) != VK_SUCCESS) {
+        vkDestroyBuffer(device, *buffer, NULL);
+        vkFreeMemory(device, *memory, NULL);
+        *buffer = VK_NULL_HANDLE;
+        *memory = VK_NULL_HANDLE;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    return VK_SUCCESS;
+}
+
+static void destroyMeshStaging(void) {
+    if (meshStagingData) vkUnmapMemory(device, meshStagingMemory);
+    if (meshStagingBuffer) vkDestroyBuffer(device, meshStagingBuffer, NULL);
+    if (meshStagingMemory) vkFreeMemory(device, meshStagingMemory, NULL);
+
+    meshStagingData = NULL;
+    meshStagingBuffer = VK_NULL_HANDLE;
+    meshStagingMemory = VK_NULL_HANDLE;
+
+    closeMesh(&mesh);
+}
+
+static void destroyMeshBuffers(void) {
+    if (meshVertexBuffer) vkDestroyBuffer(device, meshVertexBuffer, NULL);
+    if (meshVertexMemory) vkFreeMemory(device, meshVertexMemory, NULL);
+    if (meshIndexBuffer) vkDestroyBuffer(device, meshIndexBuffer, NULL);
+    if (meshIndexMemory) vkFreeMemory(device, meshIndexMemory, NULL);
+
+    meshVertexBuffer = VK_NULL_HANDLE;
+    meshVertexMemory = VK_NULL_HANDLE;
+    meshIndexBuffer = VK_NULL_HANDLE;
+    meshIndexMemory = VK_NULL_HANDLE;
+}
+
+static void beginCommandZone(VkCommandBuffer commandBuffer, const char *name) {
+    PROFILE_ZONE_BEGIN(name);
+#ifndef NDEBUG
+    if (cmdBeginDebugUtilsLabel) {
+        VkDebugUtilsLabelEXT label = {0};
+        label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+        label.pLabelName = name;
+        cmdBeginDebugUtilsLabel(commandBuffer, &label);
+    }
+#endif
+}
+
+static void endCommandZone(VkCommandBuffer commandBuffer) {
+#ifndef NDEBUG
+    if (cmdEndDebugUtilsLabel) cmdEndDebugUtilsLabel(commandBuffer);
+#endif
+    PROFILE_ZONE_END();
+}
+
+static void beginQueueZone(VkQueue queue, const char *name) {
+    PROFILE_ZONE_BEGIN(name);
+#ifndef NDEBUG
+    if (queueBeginDebugUtilsLabel) {
+        VkDebugUtilsLabelEXT label = {0};
+        label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+        label.pLabelName = name;
+        queueBeginDebugUtilsLabel(queue, &label);
+    }
+#endif
+}
+
+static void endQueueZone(VkQueue queue) {
+#ifndef NDEBUG
+    if (queueEndDebugUtilsLabel) queueEndDebugUtilsLabel(queue);
+#endif
+    PROFILE_ZONE_END();
 }
\ No newline at end of file
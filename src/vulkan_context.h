@@ -19,6 +19,14 @@ struct SwapChainSupportDetails {
     uint32_t presentModesCount;
 };
 
-int initializeVulkanContext(GLFWwindow *window);
+// sampleCount is clamped to the highest MSAA sample count the device supports
+int initializeVulkanContext(GLFWwindow *window, uint32_t sampleCount);
+
+// Start streaming a binary mesh (see mesh.h) into device local buffers
+int beginMeshUpload(const char *filename);
+// Queue up to maxChunks more chunks for upload without blocking and store how
+// many chunks are drawable in residentChunks. Call once per frame until every
+// chunk is resident. Fails if an upload can never complete, e.g. on device loss.
+int streamMeshChunks(uint32_t maxChunks, uint32_t *residentChunks);
 
 #endif
\ No newline at end of file
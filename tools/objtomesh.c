@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/mesh.h"
+
+// Converts a Wavefront OBJ file into the binary mesh container described in
+// src/mesh.h. Vertices are written as a position followed by a color (taken
+// from the optional "v x y z r g b" extension, white otherwise). Faces are
+// fan triangulated and split into chunks of at most maxChunkVertices
+// vertices, so 16 bit indices relative to each chunk are always enough.
+
+struct Vertex {
+    float position[3];
+    float color[3];
+};
+
+struct Array {
+    void *data;
+    size_t count;
+    size_t capacity;
+};
+
+static int arrayPush(struct Array *array, const void *element, size_t elementSize);
+static int readObj(FILE *file, struct Array *vertices, struct Array *triangles);
+static int writeMesh(FILE *file, const struct Array *vertices, const struct Array *triangles, uint32_t maxChunkVertices);
+static int writePadding(FILE *file, uint64_t *offset, uint64_t alignment);
+
+int main(int argc, char **argv) {
+    uint32_t maxChunkVertices = UINT16_MAX;
+    const char *inputFilename = NULL;
+    const char *outputFilename = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            char *end;
+            unsigned long value = strtoul(argv[++i], &end, 10);
+            if (*end || value < 3 || value > UINT16_MAX) {
+                fprintf(stderr, "Chunk size must be between 3 and %u vertices\n", UINT16_MAX);
+                return 1;
+            }
+            maxChunkVertices = (uint32_t) value;
+        } else if (!inputFilename) {
+            inputFilename = argv[i];
+        } else if (!outputFilename) {
+            outputFilename = argv[i];
+        } else {
+            inputFilename = NULL;
+            break;
+        }
+    }
+
+    if (!inputFilename || !outputFilename) {
+        fprintf(stderr, "Usage: %s [-c max_chunk_vertices] input.obj output.mesh\n", argv[0]);
+        return 1;
+    }
+
+    FILE *input = fopen(inputFilename, "r");
+    if (!input) {
+        fprintf(stderr, "Failed to open %s\n", inputFilename);
+        return 1;
+    }
+
+    struct Array vertices = {0};
+    struct Array triangles = {0};
+    int status = readObj(input, &vertices, &triangles);
+    fclose(input);
+
+    if (!status) {
+        fprintf(stderr, "Failed to parse %s\n", inputFilename);
+        return 1;
+    }
+
+    if (triangles.count == 0) {
+        fprintf(stderr, "%s contains no faces\n", inputFilename);
+        return 1;
+    }
+
+    FILE *output = fopen(outputFilename, "wb");
+    if (!output) {
+        fprintf(stderr, "Failed to open %s\n", outputFilename);
+        return 1;
+    }
+
+    status = writeMesh(output, &vertices, &triangles, maxChunkVertices);
+    if (fclose(output) != 0) status = 0;
+
+    if (!status) {
+        fprintf(stderr, "Failed to write %s\n", outputFilename);
+        return 1;
+    }
+
+    free(vertices.data);
+    free(triangles.data);
+
+    return 0;
+}
+
+static int arrayPush(struct Array *array, const void *element, size_t elementSize) {
+    // Grow geometrically so large meshes don't reallocate on every element
+    if (array->count == array->capacity) {
+        size_t capacity = array->capacity ? array->capacity * 2 : 256;
+        void *data = realloc(array->data, capacity * elementSize);
+        if (!data) return 0;
+        array->data = data;
+        array->capacity = capacity;
+    }
+
+    memcpy((uint8_t *) array->data + array->count * elementSize, element, elementSize);
+    array->count++;
+
+    return 1;
+}
+
+static int readObj(FILE *file, struct Array *vertices, struct Array *triangles) {
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == 'v' && line[1] == ' ') {
+            struct Vertex vertex = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+            int fields = sscanf(line + 2, "%f %f %f %f %f %f",
+                                &vertex.position[0], &vertex.position[1], &vertex.position[2],
+                                &vertex.color[0], &vertex.color[1], &vertex.color[2]);
+            if (fields != 3 && fields != 6) return 0;
+            if (!arrayPush(vertices, &vertex, sizeof(vertex))) return 0;
+        } else if (line[0] == 'f' && line[1] == ' ') {
+            // Only the position index of each "v/vt/vn" corner is used
+            uint32_t corners[3];
+            uint32_t cornerCount = 0;
+            char *token = strtok(line + 2, " \t\r\n");
+            for (; token; token = strtok(NULL, " \t\r\n")) {
+                long index = strtol(token, NULL, 10);
+                if (index < 0) index += (long) vertices->count + 1;
+                if (index < 1 || (size_t) index > vertices->count) return 0;
+
+                // Fan triangulation around the first corner
+                if (cornerCount < 3) {
+                    corners[cornerCount++] = (uint32_t) (index - 1);
+                } else {
+                    corners[1] = corners[2];
+                    corners[2] = (uint32_t) (index - 1);
+                }
+
+                if (cornerCount == 3 && !arrayPush(triangles, corners, sizeof(corners))) return 0;
+            }
+
+            if (cornerCount < 3) return 0;
+        }
+    }
+
+    return !ferror(file);
+}
+
+static int writeMesh(FILE *file, const struct Array *vertices, const struct Array *triangles, uint32_t maxChunkVertices) {
+    const struct Vertex *objVertices = (const struct Vertex *) vertices->data;
+    const uint32_t *objTriangles = (const uint32_t *) triangles->data;
+
+    struct Array chunks = {0};
+    struct Array chunkVertices = {0};
+    struct Array chunkIndices = {0};
+
+    // Maps OBJ vertices to their index inside the current chunk
+    int64_t *remap = (int64_t *) malloc(sizeof(int64_t) * vertices->count);
+    if (!remap) return 0;
+    for (size_t i = 0; i < vertices->count; ++i) remap[i] = -1;
+
+    struct MeshChunk chunk = {0};
+    size_t chunkStart = 0;
+    for (size_t triangle = 0; triangle <= triangles->count; ++triangle) {
+        // Close the current chunk when it can't take another triangle or we run out
+        if (triangle == triangles->count || chunk.vertexCount + 3 > maxChunkVertices) {
+            if (!arrayPush(&chunks, &chunk, sizeof(chunk))) return 0;
+
+            for (size_t i = chunkStart; i < chunkVertices.count; ++i)
+                remap[((const uint32_t *) chunkVertices.data)[i]] = -1;
+
+            if (triangle == triangles->count) break;
+
+            memset(&chunk, 0, sizeof(chunk));
+            chunk.firstVertex = (uint32_t) chunkVertices.count;
+            chunk.firstIndex = (uint32_t) chunkIndices.count;
+            chunkStart = chunkVertices.count;
+        }
+
+        for (size_t corner = 0; corner < 3; ++corner) {
+            uint32_t objIndex = objTriangles[triangle * 3 + corner];
+            if (remap[objIndex] < 0) {
+                remap[objIndex] = chunk.vertexCount++;
+                if (!arrayPush(&chunkVertices, &objIndex, sizeof(objIndex))) return 0;
+
+                // Grow the chunk bounds to contain the new vertex
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    float value = objVertices[objIndex].position[axis];
+                    if (chunk.vertexCount == 1 || value < chunk.boundsMin[axis]) chunk.boundsMin[axis] = value;
+                    if (chunk.vertexCount == 1 || value > chunk.boundsMax[axis]) chunk.boundsMax[axis] = value;
+                }
+            }
+
+            uint16_t index = (uint16_t) remap[objIndex];
+            if (!arrayPush(&chunkIndices, &index, sizeof(index))) return 0;
+            chunk.indexCount++;
+        }
+    }
+
+    free(remap);
+
+    // Lay out the header, chunk table and aligned vertex and index sections
+    struct MeshHeader header = {0};
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertexStride = sizeof(struct Vertex);
+    header.indexSize = sizeof(uint16_t);
+    header.chunkCount = (uint32_t) chunks.count;
+    header.chunkTableOffset = sizeof(header);
+    header.vertexCount = chunkVertices.count;
+    header.vertexOffset = header.chunkTableOffset + chunks.count * sizeof(struct MeshChunk);
+    header.vertexOffset = (header.vertexOffset + MESH_SECTION_ALIGNMENT - 1) & ~(uint64_t) (MESH_SECTION_ALIGNMENT - 1);
+    header.indexCount = chunkIndices.count;
+    header.indexOffset = header.vertexOffset + header.vertexCount * header.vertexStride;
+    header.indexOffset = (header.indexOffset + MESH_SECTION_ALIGNMENT - 1) & ~(uint64_t) (MESH_SECTION_ALIGNMENT - 1);
+
+    uint64_t offset = 0;
+    int status = fwrite(&header, sizeof(header), 1, file) == 1;
+    offset += sizeof(header);
+
+    status = status && fwrite(chunks.data, sizeof(struct MeshChunk), chunks.count, file) == chunks.count;
+    offset += chunks.count * sizeof(struct MeshChunk);
+
+    status = status && writePadding(file, &offset, MESH_SECTION_ALIGNMENT);
+    for (size_t i = 0; status && i < chunkVertices.count; ++i) {
+        const struct Vertex *vertex = &objVertices[((const uint32_t *) chunkVertices.data)[i]];
+        status = fwrite(vertex, sizeof(*vertex), 1, file) == 1;
+        offset += sizeof(*vertex);
+    }
+
+    status = status && writePadding(file, &offset, MESH_SECTION_ALIGNMENT);
+    status = status && fwrite(chunkIndices.data, sizeof(uint16_t), chunkIndices.count, file) == chunkIndices.count;
+
+    free(chunks.data);
+    free(chunkVertices.data);
+    free(chunkIndices.data);
+
+    return status;
+}
+
+static int writePadding(FILE *file, uint64_t *offset, uint64_t alignment) {
+    static const uint8_t zeros[MESH_SECTION_ALIGNMENT] = {0};
+    uint64_t padding = (alignment - *offset % alignment) % alignment;
+    *offset += padding;
+
+    return fwrite(zeros, 1, (size_t) padding, file) == padding;
+}